@@ -0,0 +1,367 @@
+#ifndef BATCHDRIVER_H
+#define BATCHDRIVER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+//____________________________________________________________________________
+/*
+ * run a dependency graph of shell commands on a local pool of worker threads
+ * - each worker has its own task queue. Idle workers steal tasks from the other queues
+ * - a task becomes ready once all its dependencies are done
+ * - a task whose outputs all exist and are more recent than its inputs is skipped, like the existence check in run_Fun4All_ReadRawData.sh
+ * - a task fails if its command returns non zero. Tasks that depend on it are not run
+ * - wall time is accumulated per stage and reported at the end
+ */
+class BatchDriver
+{
+  public:
+
+  //* task
+  class Task
+  {
+    public:
+
+    //* name, used for printout and log file
+    std::string name;
+
+    //* stage, used to group timings
+    std::string stage;
+
+    //* shell command
+    std::string command;
+
+    //* input files
+    std::vector<std::string> inputs;
+
+    //* output files
+    std::vector<std::string> outputs;
+
+    //* indices of tasks this one depends on
+    std::vector<size_t> dependencies;
+  };
+
+  //* task status
+  enum class Status
+  {
+    Pending,
+    Done,
+    Skipped,
+    Failed,
+    Cancelled
+  };
+
+  //* constructor
+  BatchDriver( const std::string& log_path = "BatchDriver-logs" ):
+    m_log_path( log_path )
+  {}
+
+  //* add task, returns its index, to be used as a dependency for subsequent tasks
+  size_t add_task( Task task )
+  {
+    m_tasks.push_back( std::move( task ) );
+    return m_tasks.size()-1;
+  }
+
+  //* run all tasks using n_threads workers
+  void run( int n_threads )
+  {
+    n_threads = std::max( 1, n_threads );
+    std::filesystem::create_directories( m_log_path );
+
+    // dependency counters and reverse dependencies
+    const size_t n_tasks = m_tasks.size();
+    m_status.assign( n_tasks, Status::Pending );
+    m_elapsed.assign( n_tasks, 0 );
+    m_dependents.assign( n_tasks, {} );
+    m_pending_dependencies.reset( new std::atomic<int>[n_tasks] );
+    m_failed_dependency.reset( new std::atomic<bool>[n_tasks] );
+    for( size_t i = 0; i < n_tasks; ++i )
+    {
+      m_pending_dependencies[i] = m_tasks[i].dependencies.size();
+      m_failed_dependency[i] = false;
+      for( const auto& dependency:m_tasks[i].dependencies ) m_dependents[dependency].push_back( i );
+    }
+
+    // distribute initially ready tasks across worker queues
+    m_queues.clear();
+    for( int i = 0; i < n_threads; ++i ) m_queues.emplace_back( new Queue );
+    m_remaining = n_tasks;
+    {
+      int worker = 0;
+      for( size_t i = 0; i < n_tasks; ++i )
+      {
+        if( m_tasks[i].dependencies.empty() )
+        {
+          m_queues[worker]->push( i );
+          worker = (worker+1)%n_threads;
+        }
+      }
+    }
+
+    // start workers
+    const auto start = clock_type::now();
+    std::vector<std::thread> workers;
+    for( int i = 0; i < n_threads; ++i ) workers.emplace_back( &BatchDriver::worker, this, i );
+    for( auto&& thread:workers ) thread.join();
+    m_total_elapsed = std::chrono::duration<double>( clock_type::now() - start ).count();
+  }
+
+  //* task status
+  Status status( size_t index ) const
+  { return m_status[index]; }
+
+  //* print per-stage report
+  void print_report( std::ostream& stream ) const
+  {
+    // format into a local stream, so that the caller stream flags are left untouched
+    std::ostringstream out;
+    class StageReport
+    {
+      public:
+      int n_tasks = 0;
+      int n_done = 0;
+      int n_skipped = 0;
+      int n_failed = 0;
+      int n_cancelled = 0;
+      double total = 0;
+      double max = 0;
+    };
+
+    // keep stages in order of first appearance
+    std::vector<std::string> stages;
+    std::map<std::string, StageReport> reports;
+    for( size_t i = 0; i < m_tasks.size(); ++i )
+    {
+      const auto& stage = m_tasks[i].stage;
+      if( reports.find( stage ) == reports.end() ) stages.push_back( stage );
+      auto& report = reports[stage];
+      ++report.n_tasks;
+      switch( m_status[i] )
+      {
+        case Status::Done: ++report.n_done; break;
+        case Status::Skipped: ++report.n_skipped; break;
+        case Status::Failed: ++report.n_failed; break;
+        case Status::Cancelled: ++report.n_cancelled; break;
+        default: break;
+      }
+      report.total += m_elapsed[i];
+      report.max = std::max( report.max, m_elapsed[i] );
+    }
+
+    out << "BatchDriver::print_report -"
+      << std::setw(24) << "stage"
+      << std::setw(8) << "tasks"
+      << std::setw(8) << "done"
+      << std::setw(8) << "skipped"
+      << std::setw(8) << "failed"
+      << std::setw(10) << "cancelled"
+      << std::setw(12) << "total (s)"
+      << std::setw(12) << "max (s)"
+      << std::endl;
+    for( const auto& stage:stages )
+    {
+      const auto& report = reports.at( stage );
+      out << "BatchDriver::print_report -"
+        << std::setw(24) << stage
+        << std::setw(8) << report.n_tasks
+        << std::setw(8) << report.n_done
+        << std::setw(8) << report.n_skipped
+        << std::setw(8) << report.n_failed
+        << std::setw(10) << report.n_cancelled
+        << std::setw(12) << std::fixed << std::setprecision(1) << report.total
+        << std::setw(12) << report.max
+        << std::endl;
+    }
+    out << "BatchDriver::print_report - wall time: " << m_total_elapsed << " s" << std::endl;
+    stream << out.str();
+  }
+
+  private:
+
+  using clock_type = std::chrono::steady_clock;
+
+  //* per worker task queue. Owner pops from the back, thieves steal from the front
+  class Queue
+  {
+    public:
+
+    void push( size_t index )
+    {
+      std::lock_guard<std::mutex> lock( m_mutex );
+      m_tasks.push_back( index );
+    }
+
+    bool pop( size_t& index )
+    {
+      std::lock_guard<std::mutex> lock( m_mutex );
+      if( m_tasks.empty() ) return false;
+      index = m_tasks.back();
+      m_tasks.pop_back();
+      return true;
+    }
+
+    bool steal( size_t& index )
+    {
+      std::lock_guard<std::mutex> lock( m_mutex );
+      if( m_tasks.empty() ) return false;
+      index = m_tasks.front();
+      m_tasks.pop_front();
+      return true;
+    }
+
+    private:
+    std::mutex m_mutex;
+    std::deque<size_t> m_tasks;
+  };
+
+  //* worker loop
+  void worker( int id )
+  {
+    const int n_queues = m_queues.size();
+    while( m_remaining > 0 )
+    {
+      // own queue first, then steal
+      size_t index = 0;
+      bool found = m_queues[id]->pop( index );
+      for( int i = 1; i < n_queues && !found; ++i )
+      { found = m_queues[(id+i)%n_queues]->steal( index ); }
+
+      if( !found )
+      {
+        std::unique_lock<std::mutex> lock( m_mutex );
+        m_condition.wait_for( lock, std::chrono::milliseconds( 50 ) );
+        continue;
+      }
+
+      execute( index );
+
+      // release dependents, on own queue
+      for( const auto& dependent:m_dependents[index] )
+      {
+        if( m_status[index] != Status::Done && m_status[index] != Status::Skipped ) m_failed_dependency[dependent] = true;
+        if( --m_pending_dependencies[dependent] == 0 ) m_queues[id]->push( dependent );
+      }
+
+      --m_remaining;
+      m_condition.notify_all();
+    }
+  }
+
+  //* execute task
+  void execute( size_t index )
+  {
+    const auto& task = m_tasks[index];
+    if( m_failed_dependency[index] )
+    {
+      m_status[index] = Status::Cancelled;
+      print( task, "cancelled" );
+      return;
+    }
+
+    if( is_up_to_date( task ) )
+    {
+      m_status[index] = Status::Skipped;
+      print( task, "up to date" );
+      return;
+    }
+
+    print( task, "started" );
+    const auto logfile = m_log_path + "/" + task.name + ".txt";
+    const auto command = "( " + task.command + " ) > " + logfile + " 2>&1";
+    const auto start = clock_type::now();
+    const int result = std::system( command.c_str() );
+    m_elapsed[index] = std::chrono::duration<double>( clock_type::now() - start ).count();
+
+    // consider the task failed if its outputs are missing, even if the command succeeded
+    const bool success = result == 0 && std::all_of( task.outputs.begin(), task.outputs.end(),
+      []( const std::string& output ) { return std::filesystem::exists( output ); } );
+    m_status[index] = success ? Status::Done:Status::Failed;
+    print( task, success ? "done":"failed, see "+logfile );
+  }
+
+  //* true if all outputs exist and are more recent than all inputs
+  static bool is_up_to_date( const Task& task )
+  {
+    if( task.outputs.empty() ) return false;
+
+    std::filesystem::file_time_type oldest_output = std::filesystem::file_time_type::max();
+    for( const auto& output:task.outputs )
+    {
+      std::error_code error;
+      const auto time = std::filesystem::last_write_time( output, error );
+      if( error ) return false;
+      oldest_output = std::min( oldest_output, time );
+    }
+
+    for( const auto& input:task.inputs )
+    {
+      std::error_code error;
+      const auto time = std::filesystem::last_write_time( input, error );
+      if( !error && time > oldest_output ) return false;
+    }
+
+    return true;
+  }
+
+  //* printout
+  void print( const Task& task, const std::string& message )
+  {
+    std::lock_guard<std::mutex> lock( m_print_mutex );
+    std::cout << "BatchDriver - " << task.name << " - " << message << std::endl;
+  }
+
+  //* log path
+  std::string m_log_path;
+
+  //* tasks
+  std::vector<Task> m_tasks;
+
+  //* task status
+  std::vector<Status> m_status;
+
+  //* elapsed time per task (s)
+  std::vector<double> m_elapsed;
+
+  //* total elapsed time (s)
+  double m_total_elapsed = 0;
+
+  //* reverse dependencies
+  std::vector<std::vector<size_t>> m_dependents;
+
+  //* number of dependencies not yet processed, per task
+  std::unique_ptr<std::atomic<int>[]> m_pending_dependencies;
+
+  //* true if any of the task dependencies failed
+  std::unique_ptr<std::atomic<bool>[]> m_failed_dependency;
+
+  //* worker queues
+  std::vector<std::unique_ptr<Queue>> m_queues;
+
+  //* number of tasks not yet processed
+  std::atomic<size_t> m_remaining = 0;
+
+  //* mutex and condition used to wake up idle workers
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+
+  //* printout mutex
+  std::mutex m_print_mutex;
+
+};
+
+#endif
@@ -0,0 +1,348 @@
+#ifndef BCOALIGNMENT_H
+#define BCOALIGNMENT_H
+
+#include <TString.h>
+#include <TTree.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * align the event sequences of two detectors using their trigger clocks
+ * the reference sequence (TPOT lvl1 bco) is compared to the other sequence (MBD clk, INTT bco)
+ * - a first matching position is found for any offset between the two sequences, in a time proportional to that offset,
+ *   either by hashing windows of consecutive clock deltas
+ *   (for clocks that do not share the same origin or roll over, like the MBD 16 bits clock)
+ *   or by hashing absolute clock values (for clocks that are identical to the reference, like the INTT bco)
+ * - sequences are then walked in a single pass, comparing absolute clock values directly,
+ *   or predicting the next clock value from the reference clock delta.
+ *   Modular arithmetic takes care of the other clock rollover, and events missing in either sequence are skipped.
+ *   If no match is found after too many skipped events, the synchronization is searched again from the current position.
+ */
+namespace BcoAlignment
+{
+
+  //* signed difference between two clock values, modulo mask+1
+  inline int64_t clock_difference( uint64_t first, uint64_t second, uint64_t mask )
+  {
+    const uint64_t delta = (first - second)&mask;
+    return delta > mask/2 ? -int64_t( (mask - delta) + 1 ):int64_t( delta );
+  }
+
+  //* alignment configuration
+  class Config
+  {
+    public:
+
+    //* other clock mask. Use 0xffff for the MBD clock, ~0 for a non rolling clock
+    uint64_t mask = ~uint64_t(0);
+
+    //* maximum difference between predicted and actual other clock for events to match
+    uint64_t tolerance = 1;
+
+    //* true if other clock shares the same origin as the reference clock. Absolute values are used to find a first match
+    bool absolute = false;
+
+    //* number of consecutive deltas that must be identical for a first match, when not using absolute values
+    size_t window = 4;
+
+    //* number of entries, in both sequences, initially scanned when looking for a first match. Doubled until a match is found
+    size_t search_window = 256;
+
+    //* maximum number of consecutive skipped events before searching for a new first match
+    size_t max_skip = 50;
+
+    //* log resynchronisations
+    bool verbose = true;
+  };
+
+  //* alignment statistics
+  class Statistics
+  {
+    public:
+
+    //* number of matched pairs
+    size_t n_matched = 0;
+
+    //* number of skipped reference events
+    size_t n_ref_skipped = 0;
+
+    //* number of skipped other events
+    size_t n_other_skipped = 0;
+
+    //* number of times events were skipped before matching again
+    size_t n_resync = 0;
+
+    //* number of times synchronization was lost, and searched again
+    size_t n_search = 0;
+
+    //* print
+    void print( std::ostream& out, const std::string& name ) const
+    {
+      out << name << " -"
+        << " matched: " << n_matched
+        << " ref_skipped: " << n_ref_skipped
+        << " other_skipped: " << n_other_skipped
+        << " resync: " << n_resync
+        << " search: " << n_search
+        << std::endl;
+    }
+
+  };
+
+  //____________________________________________________________________________
+  class Aligner
+  {
+    public:
+
+    using position_t = std::pair<size_t, size_t>;
+
+    //* constructor
+    Aligner( const Config& config = Config() ):
+      m_config( config )
+    {}
+
+    /*
+     * find first matching position, starting from given positions in reference and other sequences
+     * the scanned window starts at search_window entries and is doubled until a match is found,
+     * so that any offset is found, at a cost proportional to the distance to the match
+     */
+    std::optional<position_t> find_first_match( const std::vector<uint64_t>& ref, size_t ref_begin, const std::vector<uint64_t>& other, size_t other_begin ) const
+    {
+      if( ref_begin >= ref.size() || other_begin >= other.size() ) return std::nullopt;
+      for( size_t range = std::max<size_t>( m_config.search_window, 2*m_config.window+2 );; range *= 2 )
+      {
+        const size_t ref_end = std::min( ref.size(), ref_begin+range );
+        const size_t other_end = std::min( other.size(), other_begin+range );
+        const auto result = m_config.absolute ?
+          find_first_match_absolute( ref, ref_begin, ref_end, other, other_begin, other_end ):
+          find_first_match_deltas( ref, ref_begin, ref_end, other, other_begin, other_end );
+        if( result ) return result;
+        if( ref_end == ref.size() && other_end == other.size() ) return std::nullopt;
+      }
+    }
+
+    /*
+     * walk both sequences, calling callback( ref_index, other_index ) for each matched pair
+     * pairs are passed in increasing order of both indices
+     */
+    template<class F>
+      Statistics align( const std::vector<uint64_t>& ref, const std::vector<uint64_t>& other, F&& callback ) const
+    {
+      Statistics statistics;
+      size_t i = 0;
+      size_t j = 0;
+
+      // state machine: searching for a first match, or locked to last matched pair
+      bool locked = false;
+      size_t i_last = 0;
+      size_t j_last = 0;
+      size_t n_ref_skipped = 0;
+      size_t n_other_skipped = 0;
+
+      while( i < ref.size() && j < other.size() )
+      {
+        if( !locked )
+        {
+          const auto position = find_first_match( ref, i, other, j );
+          if( !position ) break;
+
+          std::tie( i, j ) = *position;
+          if( m_config.verbose )
+          {
+            std::cout << "BcoAlignment::Aligner::align -"
+              << " synchronized at ref entry: " << i
+              << " other entry: " << j
+              << std::endl;
+          }
+
+          ++statistics.n_matched;
+          callback( i, j );
+          locked = true;
+          i_last = i++;
+          j_last = j++;
+          continue;
+        }
+
+        /*
+         * compare other clock to the reference clock directly when both share the same origin.
+         * Otherwise predict it from the reference clock delta since the last matched pair.
+         * Using the prediction for absolute clocks would double the reference clock jitter
+         */
+        const uint64_t predicted = m_config.absolute ? ref[i]:other[j_last] + (ref[i] - ref[i_last]);
+        const auto difference = clock_difference( other[j], predicted, m_config.mask );
+        if( uint64_t( std::abs( difference ) ) <= m_config.tolerance )
+        {
+          if( n_ref_skipped || n_other_skipped )
+          {
+            ++statistics.n_resync;
+            if( m_config.verbose )
+            {
+              std::cout << "BcoAlignment::Aligner::align -"
+                << " resynchronized at ref entry: " << i
+                << " other entry: " << j
+                << " ref_skipped: " << n_ref_skipped
+                << " other_skipped: " << n_other_skipped
+                << std::endl;
+            }
+            n_ref_skipped = 0;
+            n_other_skipped = 0;
+          }
+
+          ++statistics.n_matched;
+          callback( i, j );
+          i_last = i++;
+          j_last = j++;
+          continue;
+        }
+
+        if( difference < 0 )
+        {
+          // other event comes earlier than expected: it is missing from the reference sequence
+          ++j;
+          ++n_other_skipped;
+          ++statistics.n_other_skipped;
+        } else {
+          // other event comes later than expected: reference event is missing from the other sequence
+          ++i;
+          ++n_ref_skipped;
+          ++statistics.n_ref_skipped;
+        }
+
+        if( n_ref_skipped + n_other_skipped > m_config.max_skip )
+        {
+          if( m_config.verbose )
+          {
+            std::cout << "BcoAlignment::Aligner::align -"
+              << " lost synchronization after ref entry: " << i_last
+              << " other entry: " << j_last
+              << std::endl;
+          }
+          ++statistics.n_search;
+          locked = false;
+          i = i_last+1;
+          j = j_last+1;
+          n_ref_skipped = 0;
+          n_other_skipped = 0;
+        }
+      }
+
+      return statistics;
+    }
+
+    private:
+
+    //* find first match using windows of consecutive deltas
+    std::optional<position_t> find_first_match_deltas(
+      const std::vector<uint64_t>& ref, size_t ref_begin, size_t ref_end,
+      const std::vector<uint64_t>& other, size_t other_begin, size_t other_end ) const
+    {
+      const size_t window = m_config.window;
+      if( ref_end - ref_begin < window+1 || other_end - other_begin < window+1 ) return std::nullopt;
+
+      const auto mask = m_config.mask;
+      auto ref_delta = [&]( size_t i ) { return (ref[i+1]-ref[i])&mask; };
+      auto other_delta = [&]( size_t i ) { return (other[i+1]-other[i])&mask; };
+
+      // index all other windows by hash. Keep first occurrence only
+      std::unordered_map<uint64_t, size_t> index;
+      index.reserve( other_end - other_begin );
+      uint64_t power = 1;
+      for( size_t k = 1; k < window; ++k ) power *= hash_base;
+
+      uint64_t hash = 0;
+      for( size_t k = 0; k < window; ++k ) hash = hash*hash_base + other_delta( other_begin+k );
+      for( size_t j = other_begin;; ++j )
+      {
+        index.emplace( hash, j );
+        if( j+window+1 >= other_end ) break;
+        hash = (hash - other_delta( j )*power)*hash_base + other_delta( j+window );
+      }
+
+      // scan reference windows, verify candidates
+      hash = 0;
+      for( size_t k = 0; k < window; ++k ) hash = hash*hash_base + ref_delta( ref_begin+k );
+      for( size_t i = ref_begin;; ++i )
+      {
+        const auto iter = index.find( hash );
+        if( iter != index.end() )
+        {
+          const size_t j = iter->second;
+          bool matched = true;
+          for( size_t k = 0; k < window && matched; ++k )
+          { matched = ref_delta( i+k ) == other_delta( j+k ); }
+          if( matched ) return std::make_pair( i, j );
+        }
+
+        if( i+window+1 >= ref_end ) break;
+        hash = (hash - ref_delta( i )*power)*hash_base + ref_delta( i+window );
+      }
+
+      return std::nullopt;
+    }
+
+    //* find first match using absolute clock values
+    std::optional<position_t> find_first_match_absolute(
+      const std::vector<uint64_t>& ref, size_t ref_begin, size_t ref_end,
+      const std::vector<uint64_t>& other, size_t other_begin, size_t other_end ) const
+    {
+      const auto mask = m_config.mask;
+      std::unordered_map<uint64_t, size_t> index;
+      index.reserve( other_end - other_begin );
+      for( size_t j = other_begin; j < other_end; ++j )
+      { index.emplace( other[j]&mask, j ); }
+
+      const int64_t tolerance = m_config.tolerance;
+      for( size_t i = ref_begin; i < ref_end; ++i )
+        for( int64_t offset = -tolerance; offset <= tolerance; ++offset )
+      {
+        const auto iter = index.find( (ref[i]+offset)&mask );
+        if( iter != index.end() ) return std::make_pair( i, iter->second );
+      }
+
+      return std::nullopt;
+    }
+
+    //* hash base (64 bits FNV prime)
+    static constexpr uint64_t hash_base = 0x100000001b3;
+
+    //* configuration
+    Config m_config;
+
+  };
+
+  //____________________________________________________________________________
+  /*
+   * read clock values for all entries of a tree, enabling only the branches needed to evaluate get_clock()
+   * all branches are enabled again on return
+   */
+  template<class F>
+    std::vector<uint64_t> read_clock( TTree* tree, const std::vector<TString>& branches, F&& get_clock )
+  {
+    tree->SetBranchStatus( "*", 0 );
+    for( const auto& branch:branches ) tree->SetBranchStatus( branch, 1 );
+
+    const auto entries = tree->GetEntries();
+    std::vector<uint64_t> clocks;
+    clocks.reserve( entries );
+    for( Long64_t i = 0; i < entries; ++i )
+    {
+      tree->GetEntry(i);
+      clocks.push_back( get_clock() );
+    }
+
+    tree->SetBranchStatus( "*", 1 );
+    return clocks;
+  }
+
+}
+
+#endif
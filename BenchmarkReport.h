@@ -0,0 +1,204 @@
+#ifndef BENCHMARKREPORT_H
+#define BENCHMARKREPORT_H
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+//____________________________________________________________________________
+/*
+ * per stage timing, event count and bytes read, with machine readable (json) output
+ * stages are reported in order of creation. Time is accumulated, so that a stage can be
+ * measured piecewise inside an event loop
+ */
+class BenchmarkReport
+{
+  public:
+
+  using clock_type = std::chrono::steady_clock;
+
+  //* stage
+  class Stage
+  {
+    public:
+
+    //* name
+    std::string name;
+
+    //* accumulated time (s)
+    double time = 0;
+
+    //* number of processed events
+    long long n_events = 0;
+
+    //* number of bytes read from file
+    long long bytes_read = 0;
+
+    //* events per second
+    double events_per_second() const
+    { return time > 0 ? n_events/time:0; }
+  };
+
+  //* constructor
+  BenchmarkReport( const std::string& name ):
+    m_name( name )
+  {}
+
+  //* get stage matching name, create if not found
+  Stage& stage( const std::string& name )
+  {
+    for( auto&& stage:m_stages )
+    { if( stage.name == name ) return stage; }
+    m_stages.push_back( Stage() );
+    m_stages.back().name = name;
+    return m_stages.back();
+  }
+
+  //* run function and add elapsed time to a given stage. Stage references stay valid when new stages are added
+  template<class F>
+    void time( Stage& stage, F&& function )
+  {
+    const auto start = clock_type::now();
+    function();
+    stage.time += std::chrono::duration<double>( clock_type::now() - start ).count();
+  }
+
+  //* run function and add elapsed time to a given stage, found by name. Use the Stage& version in event loops
+  template<class F>
+    void time( const std::string& name, F&& function )
+  { time( stage( name ), std::forward<F>( function ) ); }
+
+  //* add configuration parameter
+  void add_parameter( const std::string& name, double value )
+  { m_parameters.emplace_back( name, value ); }
+
+  //* add result, e.g. number of matched events, to check that a change does not alter the output
+  void add_result( const std::string& name, double value )
+  { m_results.emplace_back( name, value ); }
+
+  //* number of processed events, used for the overall throughput
+  void set_n_events( long long value )
+  { m_n_events = value; }
+
+  //* total processing time (s), used for the overall throughput
+  void set_wall_time( double value )
+  { m_wall_time = value; }
+
+  //* peak resident memory (kB)
+  static long peak_rss()
+  {
+    rusage usage;
+    getrusage( RUSAGE_SELF, &usage );
+    return usage.ru_maxrss;
+  }
+
+  //* print
+  void print( std::ostream& out ) const
+  {
+    for( const auto& stage:m_stages )
+    {
+      out << "BenchmarkReport::print -"
+        << " stage: " << std::setw(20) << std::left << stage.name << std::right
+        << " time: " << std::setw(10) << stage.time << " s"
+        << " events/s: " << std::setw(10) << stage.events_per_second()
+        << " bytes read: " << stage.bytes_read
+        << std::endl;
+    }
+
+    out << "BenchmarkReport::print -"
+      << " events: " << m_n_events
+      << " wall time: " << m_wall_time << " s"
+      << " events/s: " << events_per_second()
+      << " bytes read: " << bytes_read()
+      << " peak rss: " << peak_rss() << " kB"
+      << std::endl;
+  }
+
+  //* write json
+  void write_json( std::ostream& out ) const
+  {
+    out << "{" << std::endl;
+    out << "  \"benchmark\": \"" << m_name << "\"," << std::endl;
+    write_values( out, "config", m_parameters );
+    write_values( out, "results", m_results );
+    out << "  \"events\": " << m_n_events << "," << std::endl;
+    out << "  \"wall_time\": " << m_wall_time << "," << std::endl;
+    out << "  \"events_per_second\": " << events_per_second() << "," << std::endl;
+    out << "  \"bytes_read\": " << bytes_read() << "," << std::endl;
+    out << "  \"peak_rss_kb\": " << peak_rss() << "," << std::endl;
+    out << "  \"stages\": [" << std::endl;
+    for( size_t i = 0; i < m_stages.size(); ++i )
+    {
+      const auto& stage = m_stages[i];
+      out << "    {"
+        << " \"name\": \"" << stage.name << "\","
+        << " \"time\": " << stage.time << ","
+        << " \"events\": " << stage.n_events << ","
+        << " \"events_per_second\": " << stage.events_per_second() << ","
+        << " \"bytes_read\": " << stage.bytes_read
+        << " }" << (i+1 < m_stages.size() ? ",":"") << std::endl;
+    }
+    out << "  ]" << std::endl;
+    out << "}" << std::endl;
+  }
+
+  //* write json to file
+  bool write_json( const std::string& filename ) const
+  {
+    std::ofstream out( filename );
+    if( !out ) return false;
+    write_json( out );
+    return true;
+  }
+
+  private:
+
+  //* events per second
+  double events_per_second() const
+  { return m_wall_time > 0 ? m_n_events/m_wall_time:0; }
+
+  //* total bytes read
+  long long bytes_read() const
+  {
+    long long out = 0;
+    for( const auto& stage:m_stages ) out += stage.bytes_read;
+    return out;
+  }
+
+  //* write named values as a json object
+  static void write_values( std::ostream& out, const std::string& name, const std::vector<std::pair<std::string, double>>& values )
+  {
+    out << "  \"" << name << "\": {";
+    for( size_t i = 0; i < values.size(); ++i )
+    { out << (i ? ", ":" ") << "\"" << values[i].first << "\": " << values[i].second; }
+    out << " }," << std::endl;
+  }
+
+  //* benchmark name
+  std::string m_name;
+
+  //* stages. A deque is used so that references to existing stages are not invalidated
+  std::deque<Stage> m_stages;
+
+  //* configuration parameters
+  std::vector<std::pair<std::string, double>> m_parameters;
+
+  //* results
+  std::vector<std::pair<std::string, double>> m_results;
+
+  //* number of processed events
+  long long m_n_events = 0;
+
+  //* total processing time (s)
+  double m_wall_time = 0;
+
+};
+
+#endif
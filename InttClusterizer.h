@@ -0,0 +1,151 @@
+#ifndef INTTCLUSTERIZER_H
+#define INTTCLUSTERIZER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//____________________________________________________________________________
+/*
+ * INTT clustering on a packed hit array
+ * each hit is packed in a 16 bits key: chan_id + 128*(chip_id + 26*module)
+ * keys are ordered with a two pass radix sort, and clusters are formed from runs of adjacent channels in the same chip.
+ * Buffers are cleared rather than reallocated between events, so that there is no heap allocation once the
+ * largest event has been processed
+ */
+class InttClusterizer
+{
+  public:
+
+  //* number of modules
+  static constexpr int n_modules = 14;
+
+  //* number of chips per module
+  static constexpr int n_chips = 26;
+
+  //* number of channels per chip
+  static constexpr int n_channels = 128;
+
+  //* cluster
+  class Cluster
+  {
+    public:
+
+    //* module
+    int module = 0;
+
+    //* chip
+    int chip_id = 0;
+
+    //* mean channel
+    float chan_id = 0;
+
+    //* number of hits
+    int size = 0;
+  };
+
+  //* true if hit is known to be bad: empty hit, or known noisy channel
+  static bool is_bad_hit( int chip_id, int chan_id, int adc, int bco )
+  {
+    return bco == 0 && (
+      (chip_id == 0 && chan_id == 0 && adc == 0) ||
+      (chip_id == 21 && chan_id == 126 && adc == 6) );
+  }
+
+  //* clear hits, keeping allocated memory
+  void clear()
+  { m_keys.clear(); }
+
+  //* add hit. Bad hits and hits with out of range indices are ignored
+  void add_hit( int module, int chip_id, int chan_id, int adc, int bco )
+  {
+    if( is_bad_hit( chip_id, chan_id, adc, bco ) ) return;
+    if( module < 0 || module >= n_modules || chip_id < 0 || chip_id >= n_chips || chan_id < 0 || chan_id >= n_channels ) return;
+    m_keys.push_back( chan_id + n_channels*(chip_id + n_chips*module) );
+  }
+
+  //* number of hits
+  size_t n_hits() const
+  { return m_keys.size(); }
+
+  /*
+   * sort hits, and count clusters of adjacent channels
+   * duplicated hits start a new cluster, as in the original vector based clustering
+   * cluster positions are stored in clusters, if not null
+   */
+  int count_clusters( std::vector<Cluster>* clusters = nullptr )
+  {
+    if( clusters ) clusters->clear();
+    if( m_keys.empty() ) return 0;
+
+    sort();
+
+    int n_clusters = 0;
+    Cluster cluster;
+    int sum = 0;
+    for( size_t i = 0; i < m_keys.size(); ++i )
+    {
+      const auto key = m_keys[i];
+      const bool new_cluster = (i == 0) || key != m_keys[i-1]+1 || (key%n_channels) == 0;
+      if( new_cluster )
+      {
+        if( clusters && i > 0 ) store( clusters, cluster, sum );
+        ++n_clusters;
+        cluster.module = key/(n_channels*n_chips);
+        cluster.chip_id = (key/n_channels)%n_chips;
+        cluster.size = 0;
+        sum = 0;
+      }
+
+      ++cluster.size;
+      sum += key%n_channels;
+    }
+
+    if( clusters ) store( clusters, cluster, sum );
+    return n_clusters;
+  }
+
+  private:
+
+  //* store cluster
+  static void store( std::vector<Cluster>* clusters, Cluster& cluster, int sum )
+  {
+    cluster.chan_id = float(sum)/cluster.size;
+    clusters->push_back( cluster );
+  }
+
+  //* least significant digit radix sort of the keys, one byte at a time
+  void sort()
+  {
+    m_buffer.resize( m_keys.size() );
+    for( int shift = 0; shift < 16; shift += 8 )
+    {
+      m_count.fill( 0 );
+      for( const auto& key:m_keys ) ++m_count[(key>>shift)&0xff];
+
+      uint32_t offset = 0;
+      for( auto&& count:m_count )
+      {
+        const auto current = count;
+        count = offset;
+        offset += current;
+      }
+
+      for( const auto& key:m_keys ) m_buffer[m_count[(key>>shift)&0xff]++] = key;
+      m_keys.swap( m_buffer );
+    }
+  }
+
+  //* packed hits
+  std::vector<uint16_t> m_keys;
+
+  //* sort buffer
+  std::vector<uint16_t> m_buffer;
+
+  //* radix counts
+  std::array<uint32_t, 256> m_count = {};
+
+};
+
+#endif
@@ -0,0 +1,226 @@
+#ifndef MICROMEGASANALYSISKERNELS_H
+#define MICROMEGASANALYSISKERNELS_H
+
+#include <TH1.h>
+#include <TH2.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "MicromegasRawDataSkim.h"
+
+/*
+ * compiled histogram filling kernels, used in place of TTree::Project and TH3::Project3D
+ * bin indices are computed directly from the skim channel id, and counts are stored
+ * in pre-allocated flat arrays, one 2D slice per detector (or resist region)
+ * for best performance, macros including this file should be compiled, e.g. root -b -q RawDataSignal.C+
+ */
+namespace MicromegasAnalysisKernels
+{
+
+  //____________________________________________________________________________
+  //* flat array of 2D histograms with unit-width bins starting at zero. Out of range entries are dropped
+  class SlicedHistogram
+  {
+    public:
+
+    //* constructor
+    SlicedHistogram( int n_slices, int n_x, int n_y ):
+      m_n_slices( n_slices ),
+      m_n_x( n_x ),
+      m_n_y( n_y ),
+      m_data( size_t(n_slices)*n_x*n_y, 0 )
+    {}
+
+    //* fill
+    void fill( int slice, int x, int y )
+    {
+      if( slice < 0 || slice >= m_n_slices || x < 0 || x >= m_n_x || y < 0 || y >= m_n_y ) return;
+      ++m_data[(size_t(slice)*m_n_x + x)*m_n_y + y];
+    }
+
+    //* content
+    uint32_t get( int slice, int x, int y ) const
+    { return m_data[(size_t(slice)*m_n_x + x)*m_n_y + y]; }
+
+    //* number of slices
+    int n_slices() const
+    { return m_n_slices; }
+
+    //* number of x bins
+    int n_x() const
+    { return m_n_x; }
+
+    //* number of y bins
+    int n_y() const
+    { return m_n_y; }
+
+    //* create 2D histogram (y vs x) for a given slice
+    TH2* make_histogram( int slice, const TString& name, const TString& title ) const
+    {
+      auto h = new TH2F( name, title, m_n_x, 0, m_n_x, m_n_y, 0, m_n_y );
+      for( int ix = 0; ix < m_n_x; ++ix )
+        for( int iy = 0; iy < m_n_y; ++iy )
+      {
+        const auto content = get( slice, ix, iy );
+        if( content ) h->SetBinContent( ix+1, iy+1, content );
+      }
+      h->SetEntries( h->GetSumOfWeights() );
+      return h;
+    }
+
+    //* create 2D histogram (y vs x) with all slices side by side along x
+    TH2* make_histogram_all( const TString& name, const TString& title ) const
+    {
+      const int n_x = m_n_slices*m_n_x;
+      auto h = new TH2F( name, title, n_x, 0, n_x, m_n_y, 0, m_n_y );
+      for( int slice = 0; slice < m_n_slices; ++slice )
+        for( int ix = 0; ix < m_n_x; ++ix )
+          for( int iy = 0; iy < m_n_y; ++iy )
+      {
+        const auto content = get( slice, ix, iy );
+        if( content ) h->SetBinContent( slice*m_n_x + ix + 1, iy+1, content );
+      }
+      h->SetEntries( h->GetSumOfWeights() );
+      return h;
+    }
+
+    //* create 1D histogram (x) for a given slice, summed over y
+    TH1* make_projection_x( int slice, const TString& name, const TString& title ) const
+    {
+      auto h = new TH1F( name, title, m_n_x, 0, m_n_x );
+      for( int ix = 0; ix < m_n_x; ++ix )
+      {
+        uint64_t content = 0;
+        for( int iy = 0; iy < m_n_y; ++iy ) content += get( slice, ix, iy );
+        if( content ) h->SetBinContent( ix+1, content );
+      }
+      h->SetEntries( h->GetSumOfWeights() );
+      return h;
+    }
+
+    private:
+
+    //* number of slices
+    int m_n_slices = 0;
+
+    //* number of x bins
+    int m_n_x = 0;
+
+    //* number of y bins
+    int m_n_y = 0;
+
+    //* counts
+    std::vector<uint32_t> m_data;
+
+  };
+
+  //____________________________________________________________________________
+  //* adc vs strip, per detector
+  class SignalFiller
+  {
+    public:
+
+    //* branches needed from the skim
+    static constexpr unsigned int branches = MicromegasRawDataSkim::SampleChannel|MicromegasRawDataSkim::SampleAdc;
+
+    //* constructor
+    SignalFiller( int n_adc = 200 ):
+      m_histogram( 16, 256, n_adc )
+    {}
+
+    //* fill from event
+    void fill( const MicromegasRawDataSkim::Event& event )
+    {
+      const auto n_samples = event.sample_channel.size();
+      for( size_t i = 0; i < n_samples; ++i )
+      {
+        const auto channel = event.sample_channel[i];
+        m_histogram.fill( MicromegasRawDataSkim::get_detid( channel ), MicromegasRawDataSkim::get_strip( channel ), event.sample_adc[i] );
+      }
+    }
+
+    //* histogram
+    const SlicedHistogram& histogram() const
+    { return m_histogram; }
+
+    private:
+
+    //* histogram
+    SlicedHistogram m_histogram;
+
+  };
+
+  //____________________________________________________________________________
+  //* adc vs sample, per resist region
+  class TimingFiller
+  {
+    public:
+
+    //* branches needed from the skim
+    static constexpr unsigned int branches = MicromegasRawDataSkim::SampleChannel|MicromegasRawDataSkim::SampleSample|MicromegasRawDataSkim::SampleAdc;
+
+    //* constructor
+    TimingFiller( int n_samples = 150, int n_adc = 1200 ):
+      m_histogram( 64, n_samples, n_adc )
+    {}
+
+    //* fill from event
+    void fill( const MicromegasRawDataSkim::Event& event )
+    {
+      const auto n_samples = event.sample_channel.size();
+      for( size_t i = 0; i < n_samples; ++i )
+      { m_histogram.fill( MicromegasRawDataSkim::get_region( event.sample_channel[i] ), event.sample_sample[i], event.sample_adc[i] ); }
+    }
+
+    //* histogram
+    const SlicedHistogram& histogram() const
+    { return m_histogram; }
+
+    private:
+
+    //* histogram
+    SlicedHistogram m_histogram;
+
+  };
+
+  //____________________________________________________________________________
+  //* signal hits vs strip, per detector
+  class HitProfileFiller
+  {
+    public:
+
+    //* branches needed from the skim
+    static constexpr unsigned int branches = MicromegasRawDataSkim::WaveformChannel|MicromegasRawDataSkim::WaveformIsSignal;
+
+    //* constructor
+    HitProfileFiller():
+      m_histogram( 16, 256, 1 )
+    {}
+
+    //* fill from event
+    void fill( const MicromegasRawDataSkim::Event& event )
+    {
+      const auto n_waveforms = event.waveform_channel.size();
+      for( size_t i = 0; i < n_waveforms; ++i )
+      {
+        if( !event.waveform_is_signal[i] ) continue;
+        const auto channel = event.waveform_channel[i];
+        m_histogram.fill( MicromegasRawDataSkim::get_detid( channel ), MicromegasRawDataSkim::get_strip( channel ), 0 );
+      }
+    }
+
+    //* histogram
+    const SlicedHistogram& histogram() const
+    { return m_histogram; }
+
+    private:
+
+    //* histogram
+    SlicedHistogram m_histogram;
+
+  };
+
+}
+
+#endif
@@ -0,0 +1,273 @@
+#ifndef MICROMEGASCALIBRATIONACCUMULATOR_H
+#define MICROMEGASCALIBRATIONACCUMULATOR_H
+
+#include <TFile.h>
+#include <TParameter.h>
+#include <TString.h>
+#include <TVectorD.h>
+
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "MicromegasRawDataSkim.h"
+
+//____________________________________________________________________________
+// per channel running mean and variance (Welford), that can be merged across threads, segments or runs
+class MicromegasChannelStatistics
+{
+  public:
+
+  //* constructor
+  MicromegasChannelStatistics( int n_channels = 4096 ):
+    m_count( n_channels, 0 ),
+    m_mean( n_channels, 0 ),
+    m_m2( n_channels, 0 )
+  {}
+
+  //* number of channels
+  int n_channels() const
+  { return m_count.size(); }
+
+  //* add value to a given channel
+  void fill( int channel, double value )
+  {
+    const auto count = ++m_count[channel];
+    const double delta = value - m_mean[channel];
+    m_mean[channel] += delta/count;
+    m_m2[channel] += delta*(value - m_mean[channel]);
+  }
+
+  //* merge other statistics into this one (Chan et al.)
+  void merge( const MicromegasChannelStatistics& other )
+  {
+    for( size_t channel = 0; channel < m_count.size(); ++channel )
+    {
+      const double count_a = m_count[channel];
+      const double count_b = other.m_count[channel];
+      if( count_b == 0 ) continue;
+
+      const double count = count_a + count_b;
+      const double delta = other.m_mean[channel] - m_mean[channel];
+      m_mean[channel] += delta*count_b/count;
+      m_m2[channel] += other.m_m2[channel] + delta*delta*count_a*count_b/count;
+      m_count[channel] += other.m_count[channel];
+    }
+  }
+
+  //* number of entries for a given channel
+  double count( int channel ) const
+  { return m_count[channel]; }
+
+  //* mean for a given channel
+  double mean( int channel ) const
+  { return m_mean[channel]; }
+
+  //* rms for a given channel
+  double rms( int channel ) const
+  { return m_count[channel] ? std::sqrt( m_m2[channel]/m_count[channel] ):0; }
+
+  //*@name raw content, for serialization
+  //@{
+  const std::vector<double>& counts() const { return m_count; }
+  const std::vector<double>& means() const { return m_mean; }
+  const std::vector<double>& m2s() const { return m_m2; }
+
+  void set( std::vector<double> count, std::vector<double> mean, std::vector<double> m2 )
+  {
+    m_count = std::move( count );
+    m_mean = std::move( mean );
+    m_m2 = std::move( m2 );
+  }
+  //@}
+
+  private:
+
+  //* number of entries per channel. Stored as double for direct serialization
+  std::vector<double> m_count;
+
+  //* running mean per channel
+  std::vector<double> m_mean;
+
+  //* running sum of squared differences to the mean, per channel
+  std::vector<double> m_m2;
+
+};
+
+//____________________________________________________________________________
+/*
+ * incremental TPOT calibration accumulator
+ * keeps per channel adc mean and variance over a configurable sample window, used for pedestal and rms,
+ * and per channel signal hit counts, used for hot channel maps.
+ * Accumulators from any number of segments or runs can be merged, and saved to small checkpoint files
+ */
+class MicromegasCalibrationAccumulator
+{
+  public:
+
+  //* number of channels (16 detectors, 256 strips each)
+  static constexpr int n_channels = 4096;
+
+  //* checkpoint format version. Increment whenever the content written to checkpoints changes
+  static constexpr int version = 1;
+
+  //* constructor. Samples in [sample_min, sample_max) are used for pedestal and rms
+  MicromegasCalibrationAccumulator( int sample_min = 0, int sample_max = 20 ):
+    m_sample_min( sample_min ),
+    m_sample_max( sample_max ),
+    m_statistics( n_channels ),
+    m_signal_hits( n_channels, 0 )
+  {}
+
+  //* skim branches needed by fill
+  static constexpr unsigned int branches =
+    MicromegasRawDataSkim::AllSamples|
+    MicromegasRawDataSkim::WaveformChannel|
+    MicromegasRawDataSkim::WaveformIsSignal;
+
+  //* fill from skim event
+  void fill( const MicromegasRawDataSkim::Event& event )
+  {
+    ++m_n_events;
+
+    const auto n_samples = event.sample_channel.size();
+    for( size_t i = 0; i < n_samples; ++i )
+    {
+      const auto sample = event.sample_sample[i];
+      const auto channel = event.sample_channel[i];
+      if( sample < m_sample_min || sample >= m_sample_max || channel >= n_channels ) continue;
+      m_statistics.fill( channel, event.sample_adc[i] );
+    }
+
+    const auto n_waveforms = event.waveform_channel.size();
+    for( size_t i = 0; i < n_waveforms; ++i )
+    {
+      const auto channel = event.waveform_channel[i];
+      if( event.waveform_is_signal[i] && channel < n_channels ) ++m_signal_hits[channel];
+    }
+  }
+
+  //* merge other accumulator. Returns false if sample windows differ
+  bool merge( const MicromegasCalibrationAccumulator& other )
+  {
+    if( other.m_sample_min != m_sample_min || other.m_sample_max != m_sample_max )
+    {
+      std::cout << "MicromegasCalibrationAccumulator::merge - inconsistent sample windows" << std::endl;
+      return false;
+    }
+
+    m_n_events += other.m_n_events;
+    m_statistics.merge( other.m_statistics );
+    for( int channel = 0; channel < n_channels; ++channel )
+    { m_signal_hits[channel] += other.m_signal_hits[channel]; }
+    return true;
+  }
+
+  //* number of events
+  double n_events() const
+  { return m_n_events; }
+
+  //* number of adc samples for a given channel
+  double count( int channel ) const
+  { return m_statistics.count( channel ); }
+
+  //* pedestal for a given channel
+  double pedestal( int channel ) const
+  { return m_statistics.mean( channel ); }
+
+  //* rms for a given channel
+  double rms( int channel ) const
+  { return m_statistics.rms( channel ); }
+
+  //* number of signal hits per event for a given channel
+  double hit_rate( int channel ) const
+  { return m_n_events > 0 ? m_signal_hits[channel]/m_n_events:0; }
+
+  //* save checkpoint
+  bool write( const TString& filename ) const
+  {
+    std::unique_ptr<TFile> tfile( TFile::Open( filename, "RECREATE" ) );
+    if( !tfile ) return false;
+
+    tfile->cd();
+    TParameter<int>( "version", version ).Write();
+    TParameter<int>( "sample_min", m_sample_min ).Write();
+    TParameter<int>( "sample_max", m_sample_max ).Write();
+    TParameter<double>( "n_events", m_n_events ).Write();
+    to_vector( m_statistics.counts() ).Write( "count" );
+    to_vector( m_statistics.means() ).Write( "mean" );
+    to_vector( m_statistics.m2s() ).Write( "m2" );
+    to_vector( m_signal_hits ).Write( "signal_hits" );
+    tfile->Close();
+    return true;
+  }
+
+  //* load checkpoint. Returns false, leaving the accumulator untouched, if the checkpoint is missing, from another version or inconsistent
+  bool read( const TString& filename )
+  {
+    std::unique_ptr<TFile> tfile( TFile::Open( filename, "READ" ) );
+    if( !tfile ) return false;
+
+    std::unique_ptr<TParameter<int>> file_version( tfile->Get<TParameter<int>>( "version" ) );
+    if( !file_version || file_version->GetVal() != version )
+    {
+      std::cout << "MicromegasCalibrationAccumulator::read - unsupported checkpoint version: " << filename << std::endl;
+      return false;
+    }
+
+    std::unique_ptr<TParameter<int>> sample_min( tfile->Get<TParameter<int>>( "sample_min" ) );
+    std::unique_ptr<TParameter<int>> sample_max( tfile->Get<TParameter<int>>( "sample_max" ) );
+    std::unique_ptr<TParameter<double>> n_events( tfile->Get<TParameter<double>>( "n_events" ) );
+    std::unique_ptr<TVectorD> count( tfile->Get<TVectorD>( "count" ) );
+    std::unique_ptr<TVectorD> mean( tfile->Get<TVectorD>( "mean" ) );
+    std::unique_ptr<TVectorD> m2( tfile->Get<TVectorD>( "m2" ) );
+    std::unique_ptr<TVectorD> signal_hits( tfile->Get<TVectorD>( "signal_hits" ) );
+    if( !( sample_min && sample_max && n_events && count && mean && m2 && signal_hits ) )
+    {
+      std::cout << "MicromegasCalibrationAccumulator::read - invalid checkpoint: " << filename << std::endl;
+      return false;
+    }
+
+    if( count->GetNrows() != n_channels || mean->GetNrows() != n_channels || m2->GetNrows() != n_channels || signal_hits->GetNrows() != n_channels )
+    {
+      std::cout << "MicromegasCalibrationAccumulator::read - inconsistent number of channels: " << filename << std::endl;
+      return false;
+    }
+
+    m_sample_min = sample_min->GetVal();
+    m_sample_max = sample_max->GetVal();
+    m_n_events = n_events->GetVal();
+    m_statistics.set( from_vector( *count ), from_vector( *mean ), from_vector( *m2 ) );
+    m_signal_hits = from_vector( *signal_hits );
+    return true;
+  }
+
+  private:
+
+  //* convert std::vector to TVectorD
+  static TVectorD to_vector( const std::vector<double>& values )
+  { return TVectorD( values.size(), values.data() ); }
+
+  //* convert TVectorD to std::vector
+  static std::vector<double> from_vector( const TVectorD& values )
+  { return std::vector<double>( values.GetMatrixArray(), values.GetMatrixArray()+values.GetNrows() ); }
+
+  //* first sample used for pedestal and rms
+  int m_sample_min = 0;
+
+  //* last sample (excluded) used for pedestal and rms
+  int m_sample_max = 20;
+
+  //* number of events
+  double m_n_events = 0;
+
+  //* adc statistics
+  MicromegasChannelStatistics m_statistics;
+
+  //* signal hits per channel
+  std::vector<double> m_signal_hits;
+
+};
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef MICROMEGASEVENTBUILDER_H
+#define MICROMEGASEVENTBUILDER_H
+
+#include <micromegas/MicromegasRawDataEvaluation.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//____________________________________________________________________________
+// default clusterizer: count groups of adjacent strips in a strip-ordered array of waveforms
+inline unsigned short count_adjacent_strip_clusters(
+  const MicromegasRawDataEvaluation::Waveform* begin,
+  const MicromegasRawDataEvaluation::Waveform* end )
+{
+  if( begin == end ) return 0;
+  unsigned short n_clusters = 1;
+  for( auto current = begin+1; current != end; ++current )
+  { if( current->strip > (current-1)->strip+1 ) ++n_clusters; }
+  return n_clusters;
+}
+
+//____________________________________________________________________________
+/*
+ * streaming event builder
+ * waveforms associated to the same lvl1 bco are stored in per-detector buffers,
+ * sorted in place by strip, and cleared rather than reallocated between events
+ */
+class MicromegasEventBuilder
+{
+  public:
+
+  using Waveform = MicromegasRawDataEvaluation::Waveform;
+
+  //* number of detectors
+  static constexpr int n_detectors = 16;
+
+  //* waveform selection
+  using selection_t = std::function<bool(const Waveform&)>;
+
+  //* clusterizer. Returns the number of clusters found in a contiguous, strip-ordered array of waveforms
+  using clusterizer_t = std::function<unsigned short(const Waveform*, const Waveform*)>;
+
+  //* constructor
+  MicromegasEventBuilder():
+    m_clusterizer( count_adjacent_strip_clusters )
+  {}
+
+  //* waveform selection
+  void set_selection( selection_t selection )
+  { m_selection = std::move( selection ); }
+
+  //* clusterizer
+  void set_clusterizer( clusterizer_t clusterizer )
+  { m_clusterizer = std::move( clusterizer ); }
+
+  //* add waveforms from one tree entry
+  void add( const Waveform::List& waveforms )
+  {
+    m_n_waveforms_all += waveforms.size();
+    for( const auto& waveform:waveforms )
+    {
+      if( !waveform.layer ) continue;
+      const int detid = waveform.tile + 8*(waveform.layer-55);
+      if( detid < 0 || detid >= n_detectors ) continue;
+      if( m_selection && !m_selection( waveform ) ) continue;
+
+      m_buffers[detid].push_back( waveform );
+      ++m_n_waveforms_signal;
+    }
+  }
+
+  //* sort waveforms by strip in each detector, and remove duplicated strips
+  void build()
+  {
+    for( auto&& buffer:m_buffers )
+    {
+      std::sort( buffer.begin(), buffer.end(), []( const Waveform& lhs, const Waveform& rhs ) { return lhs.strip < rhs.strip; } );
+      buffer.erase(
+        std::unique( buffer.begin(), buffer.end(), []( const Waveform& lhs, const Waveform& rhs ) { return lhs.strip == rhs.strip; } ),
+        buffer.end() );
+    }
+  }
+
+  //* clear all buffers. Allocated memory is kept for the next event
+  void clear()
+  {
+    for( auto&& buffer:m_buffers ) buffer.clear();
+    m_n_waveforms_all = 0;
+    m_n_waveforms_signal = 0;
+  }
+
+  //* number of waveforms added since last clear, before selection
+  size_t n_waveforms_all() const
+  { return m_n_waveforms_all; }
+
+  //* number of selected waveforms since last clear
+  size_t n_waveforms_signal() const
+  { return m_n_waveforms_signal; }
+
+  //* waveforms for a given detector. Only strip-ordered after build()
+  const std::vector<Waveform>& waveforms( int detid ) const
+  { return m_buffers[detid]; }
+
+  //* number of clusters in a given detector. Must be called after build()
+  unsigned short n_clusters( int detid ) const
+  {
+    const auto& buffer = m_buffers[detid];
+    return m_clusterizer( buffer.data(), buffer.data()+buffer.size() );
+  }
+
+  private:
+
+  //* waveform selection
+  selection_t m_selection;
+
+  //* clusterizer
+  clusterizer_t m_clusterizer;
+
+  //* per detector waveform buffers
+  std::array<std::vector<Waveform>, n_detectors> m_buffers;
+
+  //* number of waveforms before selection
+  size_t m_n_waveforms_all = 0;
+
+  //* number of selected waveforms
+  size_t m_n_waveforms_signal = 0;
+
+};
+
+//____________________________________________________________________________
+// keep track of processed events and waveforms per unit of time
+class ThroughputCounter
+{
+  public:
+
+  using clock_type = std::chrono::steady_clock;
+
+  //* start timer
+  void start()
+  {
+    m_start = clock_type::now();
+    m_n_events = 0;
+    m_n_waveforms = 0;
+  }
+
+  //* add processed event
+  void add_event( size_t n_waveforms )
+  {
+    ++m_n_events;
+    m_n_waveforms += n_waveforms;
+  }
+
+  //* elapsed time (s)
+  double elapsed() const
+  { return std::chrono::duration<double>( clock_type::now() - m_start ).count(); }
+
+  //* number of events
+  size_t n_events() const
+  { return m_n_events; }
+
+  //* number of waveforms
+  size_t n_waveforms() const
+  { return m_n_waveforms; }
+
+  //* print
+  void print( std::ostream& out, const std::string& name ) const
+  {
+    const auto time = elapsed();
+    out << name << " -"
+      << " events: " << m_n_events
+      << " waveforms: " << m_n_waveforms
+      << " time: " << time << " s"
+      << " events/s: " << (time > 0 ? m_n_events/time:0)
+      << " waveforms/s: " << (time > 0 ? m_n_waveforms/time:0)
+      << std::endl;
+  }
+
+  private:
+
+  //* start time
+  clock_type::time_point m_start = clock_type::now();
+
+  //* number of events
+  size_t m_n_events = 0;
+
+  //* number of waveforms
+  size_t m_n_waveforms = 0;
+
+};
+
+#endif
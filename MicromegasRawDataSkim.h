@@ -0,0 +1,301 @@
+#ifndef MICROMEGASRAWDATASKIM_H
+#define MICROMEGASRAWDATASKIM_H
+
+#include <TFile.h>
+#include <TString.h>
+#include <TTree.h>
+
+#include <iostream>
+#include <memory>
+#include <vector>
+
+/*
+ * flat, structure of arrays copy of the MicromegasRawDataEvaluation tree
+ * each field of the samples and waveforms is stored in a separate branch,
+ * so that macros only read and decompress what they actually use.
+ * detector layer, tile and strip are packed in a single 12 bits channel id:
+ * channel = strip + 256*tile + 2048*(layer-55)
+ */
+namespace MicromegasRawDataSkim
+{
+
+  //* pack layer, tile and strip into a channel id
+  inline unsigned short get_channel( int layer, int tile, int strip )
+  { return strip + 256*tile + 2048*(layer-55); }
+
+  //* layer from channel id
+  inline int get_layer( unsigned short channel )
+  { return 55 + (channel>>11); }
+
+  //* tile from channel id
+  inline int get_tile( unsigned short channel )
+  { return (channel>>8)&0x7; }
+
+  //* strip from channel id
+  inline int get_strip( unsigned short channel )
+  { return channel&0xff; }
+
+  //* detector index (tile + 8*(layer-55)) from channel id
+  inline int get_detid( unsigned short channel )
+  { return channel>>8; }
+
+  //* resist region index (strip/64 + 4*detid) from channel id
+  inline int get_region( unsigned short channel )
+  { return channel>>6; }
+
+  //* branches. Used to select which ones are loaded by the reader
+  enum Branch: unsigned int
+  {
+    Entry = 1<<0,
+    Lvl1 = 1<<1,
+    SampleChannel = 1<<2,
+    SampleSample = 1<<3,
+    SampleAdc = 1<<4,
+    WaveformChannel = 1<<5,
+    WaveformSampleMax = 1<<6,
+    WaveformAdcMax = 1<<7,
+    WaveformPedestal = 1<<8,
+    WaveformRms = 1<<9,
+    WaveformIsSignal = 1<<10,
+
+    AllSamples = SampleChannel|SampleSample|SampleAdc,
+    AllWaveforms = WaveformChannel|WaveformSampleMax|WaveformAdcMax|WaveformPedestal|WaveformRms|WaveformIsSignal,
+    All = Entry|Lvl1|AllSamples|AllWaveforms
+  };
+
+  //____________________________________________________________________________
+  //* content of one skim entry
+  class Event
+  {
+    public:
+
+    //* clear all fields, keeping allocated memory
+    void clear()
+    {
+      entry = 0;
+      lvl1_bco_list.clear();
+      lvl1_count_list.clear();
+      sample_channel.clear();
+      sample_sample.clear();
+      sample_adc.clear();
+      waveform_channel.clear();
+      waveform_sample_max.clear();
+      waveform_adc_max.clear();
+      waveform_pedestal.clear();
+      waveform_rms.clear();
+      waveform_is_signal.clear();
+    }
+
+    //* entry index in the original evaluation tree
+    Long64_t entry = 0;
+
+    //* lvl1 bco, per packet
+    std::vector<ULong64_t> lvl1_bco_list;
+
+    //* lvl1 counter, per packet
+    std::vector<UInt_t> lvl1_count_list;
+
+    //* sample channel id
+    std::vector<UShort_t> sample_channel;
+
+    //* sample index
+    std::vector<UShort_t> sample_sample;
+
+    //* sample adc
+    std::vector<UShort_t> sample_adc;
+
+    //* waveform channel id
+    std::vector<UShort_t> waveform_channel;
+
+    //* sample matching maximum adc
+    std::vector<UShort_t> waveform_sample_max;
+
+    //* maximum adc
+    std::vector<UShort_t> waveform_adc_max;
+
+    //* pedestal
+    std::vector<Float_t> waveform_pedestal;
+
+    //* pedestal rms
+    std::vector<Float_t> waveform_rms;
+
+    //* signal flag
+    std::vector<UChar_t> waveform_is_signal;
+
+  };
+
+  //____________________________________________________________________________
+  //* create all branches in output tree, connected to event
+  inline void create_branches( TTree* tree, Event& event )
+  {
+    tree->Branch( "entry", &event.entry );
+    tree->Branch( "lvl1_bco_list", &event.lvl1_bco_list );
+    tree->Branch( "lvl1_count_list", &event.lvl1_count_list );
+    tree->Branch( "sample_channel", &event.sample_channel );
+    tree->Branch( "sample_sample", &event.sample_sample );
+    tree->Branch( "sample_adc", &event.sample_adc );
+    tree->Branch( "waveform_channel", &event.waveform_channel );
+    tree->Branch( "waveform_sample_max", &event.waveform_sample_max );
+    tree->Branch( "waveform_adc_max", &event.waveform_adc_max );
+    tree->Branch( "waveform_pedestal", &event.waveform_pedestal );
+    tree->Branch( "waveform_rms", &event.waveform_rms );
+    tree->Branch( "waveform_is_signal", &event.waveform_is_signal );
+  }
+
+  //____________________________________________________________________________
+  /*
+   * fill event from a MicromegasRawDataEvaluation::Container
+   * samples and waveforms that do not match a valid detector are skipped.
+   * The container type is a template parameter, so that this header does not depend on libmicromegas
+   */
+  template<class T>
+    void fill_event( const T& container, Event& event )
+  {
+    event.clear();
+    event.lvl1_bco_list.assign( container.lvl1_bco_list.begin(), container.lvl1_bco_list.end() );
+    event.lvl1_count_list.assign( container.lvl1_count_list.begin(), container.lvl1_count_list.end() );
+
+    // samples
+    const auto n_samples = container.samples.size();
+    event.sample_channel.reserve( n_samples );
+    event.sample_sample.reserve( n_samples );
+    event.sample_adc.reserve( n_samples );
+    for( const auto& sample:container.samples )
+    {
+      if( sample.layer < 55 || sample.layer > 56 ) continue;
+      event.sample_channel.push_back( get_channel( sample.layer, sample.tile, sample.strip ) );
+      event.sample_sample.push_back( sample.sample );
+      event.sample_adc.push_back( sample.adc );
+    }
+
+    // waveforms
+    const auto n_waveforms = container.waveforms.size();
+    event.waveform_channel.reserve( n_waveforms );
+    event.waveform_sample_max.reserve( n_waveforms );
+    event.waveform_adc_max.reserve( n_waveforms );
+    event.waveform_pedestal.reserve( n_waveforms );
+    event.waveform_rms.reserve( n_waveforms );
+    event.waveform_is_signal.reserve( n_waveforms );
+    for( const auto& waveform:container.waveforms )
+    {
+      if( waveform.layer < 55 || waveform.layer > 56 ) continue;
+      event.waveform_channel.push_back( get_channel( waveform.layer, waveform.tile, waveform.strip ) );
+      event.waveform_sample_max.push_back( waveform.sample_max );
+      event.waveform_adc_max.push_back( waveform.adc_max );
+      event.waveform_pedestal.push_back( waveform.pedestal );
+      event.waveform_rms.push_back( waveform.rms );
+      event.waveform_is_signal.push_back( waveform.is_signal );
+    }
+  }
+
+  //____________________________________________________________________________
+  //* read skim tree, loading only requested branches
+  class Reader
+  {
+    public:
+
+    //* constructor
+    Reader( const TString& filename, unsigned int branches = All ):
+      m_branches( branches )
+    {
+      m_tfile.reset( TFile::Open( filename, "READ" ) );
+      if( !m_tfile ) return;
+
+      m_tree = static_cast<TTree*>( m_tfile->Get( "T" ) );
+      if( !m_tree ) return;
+
+      m_tree->SetBranchStatus( "*", 0 );
+      connect( Entry, "entry", &m_event.entry );
+      connect_vector( Lvl1, "lvl1_bco_list", m_lvl1_bco_list );
+      connect_vector( Lvl1, "lvl1_count_list", m_lvl1_count_list );
+      connect_vector( SampleChannel, "sample_channel", m_sample_channel );
+      connect_vector( SampleSample, "sample_sample", m_sample_sample );
+      connect_vector( SampleAdc, "sample_adc", m_sample_adc );
+      connect_vector( WaveformChannel, "waveform_channel", m_waveform_channel );
+      connect_vector( WaveformSampleMax, "waveform_sample_max", m_waveform_sample_max );
+      connect_vector( WaveformAdcMax, "waveform_adc_max", m_waveform_adc_max );
+      connect_vector( WaveformPedestal, "waveform_pedestal", m_waveform_pedestal );
+      connect_vector( WaveformRms, "waveform_rms", m_waveform_rms );
+      connect_vector( WaveformIsSignal, "waveform_is_signal", m_waveform_is_signal );
+    }
+
+    //* copy is disabled, since branch addresses point to internal members
+    Reader( const Reader& ) = delete;
+    Reader& operator = ( const Reader& ) = delete;
+
+    //* true if file and tree were found
+    bool valid() const
+    { return m_tree != nullptr; }
+
+    //* number of entries
+    Long64_t entries() const
+    { return m_tree ? m_tree->GetEntries():0; }
+
+    //* load entry. Only requested branches are read
+    void get_entry( Long64_t entry )
+    { m_tree->GetEntry( entry ); }
+
+    //* current event
+    const Event& event() const
+    { return m_event; }
+
+    //* tree
+    TTree* tree() const
+    { return m_tree; }
+
+    //* input file
+    TFile* file() const
+    { return m_tfile.get(); }
+
+    private:
+
+    //* enable branch and set address, if requested
+    template<class T>
+      void connect( Branch branch, const char* name, T* address )
+    {
+      if( !(m_branches&branch) ) return;
+      m_tree->SetBranchStatus( name, 1 );
+      m_tree->SetBranchAddress( name, address );
+    }
+
+    //* enable branch and set address, if requested, for vector branches
+    template<class T>
+      void connect_vector( Branch branch, const char* name, std::vector<T>*& address )
+    {
+      if( !(m_branches&branch) ) return;
+      m_tree->SetBranchStatus( name, 1 );
+      m_tree->SetBranchAddress( name, &address );
+    }
+
+    //* requested branches
+    unsigned int m_branches = All;
+
+    //* input file
+    std::unique_ptr<TFile> m_tfile;
+
+    //* tree
+    TTree* m_tree = nullptr;
+
+    //* event
+    Event m_event;
+
+    //*@name pointers to event vectors, as needed by TTree::SetBranchAddress
+    //@{
+    std::vector<ULong64_t>* m_lvl1_bco_list = &m_event.lvl1_bco_list;
+    std::vector<UInt_t>* m_lvl1_count_list = &m_event.lvl1_count_list;
+    std::vector<UShort_t>* m_sample_channel = &m_event.sample_channel;
+    std::vector<UShort_t>* m_sample_sample = &m_event.sample_sample;
+    std::vector<UShort_t>* m_sample_adc = &m_event.sample_adc;
+    std::vector<UShort_t>* m_waveform_channel = &m_event.waveform_channel;
+    std::vector<UShort_t>* m_waveform_sample_max = &m_event.waveform_sample_max;
+    std::vector<UShort_t>* m_waveform_adc_max = &m_event.waveform_adc_max;
+    std::vector<Float_t>* m_waveform_pedestal = &m_event.waveform_pedestal;
+    std::vector<Float_t>* m_waveform_rms = &m_event.waveform_rms;
+    std::vector<UChar_t>* m_waveform_is_signal = &m_event.waveform_is_signal;
+    //@}
+
+  };
+
+}
+
+#endif
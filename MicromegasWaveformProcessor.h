@@ -0,0 +1,257 @@
+#ifndef MICROMEGASWAVEFORMPROCESSOR_H
+#define MICROMEGASWAVEFORMPROCESSOR_H
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "MicromegasRawDataSkim.h"
+
+//____________________________________________________________________________
+/*
+ * batch waveform feature extraction and signal classification
+ * all channels of an event are stored in a (channel x sample) adc matrix.
+ * The matrix is stored sample by sample, so that for a given sample all channels are contiguous,
+ * and features are computed with inner loops over channels that the compiler can vectorize:
+ * pedestal subtraction, maximum and sample at maximum, integral and time over threshold.
+ * Channels are then classified as signal or background depending on the sample at maximum, as in RawDataClusterTree.C
+ * for best performance, macros including this file should be compiled, e.g. root -b -q RawDataWaveformFeatures.C+
+ */
+class MicromegasWaveformProcessor
+{
+  public:
+
+  //* number of channels
+  static constexpr int n_channels = 4096;
+
+  //* sample window [first, second)
+  using sample_window_t = std::pair<unsigned short, unsigned short>;
+
+  //* configuration
+  class Config
+  {
+    public:
+
+    //* number of samples per waveform. Samples beyond are ignored
+    unsigned short n_samples = 360;
+
+    //* sample window used to compute features
+    sample_window_t feature_window = {0, 360};
+
+    //* signal sample window
+    sample_window_t signal_window = {20, 45};
+
+    //* background sample window
+    sample_window_t background_window = {5, 15};
+
+    //* number of rms above pedestal for signal, and time over threshold
+    float n_sigma = 5;
+  };
+
+  //* skim branches needed by fill
+  static constexpr unsigned int branches = MicromegasRawDataSkim::AllSamples;
+
+  //* skim branches needed by set_pedestals( event )
+  static constexpr unsigned int pedestal_branches =
+    MicromegasRawDataSkim::WaveformChannel|
+    MicromegasRawDataSkim::WaveformPedestal|
+    MicromegasRawDataSkim::WaveformRms;
+
+  //* default constructor
+  MicromegasWaveformProcessor():
+    MicromegasWaveformProcessor( Config() )
+  {}
+
+  //* constructor
+  MicromegasWaveformProcessor( const Config& config ):
+    m_config( config ),
+    m_pedestal( n_channels, 0 ),
+    m_rms( n_channels, 0 ),
+    m_row( n_channels, -1 ),
+    m_adc( size_t(n_channels)*config.n_samples, 0 )
+  {}
+
+  //* configuration
+  const Config& config() const
+  { return m_config; }
+
+  //* set pedestal and rms for a given channel
+  void set_pedestal( int channel, float pedestal, float rms )
+  {
+    m_pedestal[channel] = pedestal;
+    m_rms[channel] = rms;
+  }
+
+  //* set pedestal and rms from the waveforms stored in a skim event
+  void set_pedestals( const MicromegasRawDataSkim::Event& event )
+  {
+    const auto n_waveforms = event.waveform_channel.size();
+    for( size_t i = 0; i < n_waveforms; ++i )
+    { set_pedestal( event.waveform_channel[i], event.waveform_pedestal[i], event.waveform_rms[i] ); }
+  }
+
+  //* fill adc matrix from skim event. Missing samples are set to the channel pedestal
+  void fill( const MicromegasRawDataSkim::Event& event )
+  {
+    // reset previous rows
+    for( const auto& channel:m_channels ) m_row[channel] = -1;
+    m_channels.clear();
+
+    // assign rows to channels
+    const auto n_samples = event.sample_channel.size();
+    for( size_t i = 0; i < n_samples; ++i )
+    {
+      const auto channel = event.sample_channel[i];
+      if( channel >= n_channels || m_row[channel] >= 0 ) continue;
+      m_row[channel] = m_channels.size();
+      m_channels.push_back( channel );
+    }
+
+    // per row pedestal, rms and threshold
+    const int n_rows = m_channels.size();
+    m_row_pedestal.resize( n_rows );
+    m_row_threshold.resize( n_rows );
+    m_row_valid.resize( n_rows );
+    for( int row = 0; row < n_rows; ++row )
+    {
+      const auto channel = m_channels[row];
+      m_row_pedestal[row] = m_pedestal[channel];
+      m_row_threshold[row] = m_config.n_sigma*m_rms[channel];
+      m_row_valid[row] = m_rms[channel] > 0;
+    }
+
+    // initialize matrix with pedestals, then copy adc values
+    for( int sample = 0; sample < m_config.n_samples; ++sample )
+    { std::copy( m_row_pedestal.begin(), m_row_pedestal.end(), m_adc.begin() + size_t(sample)*n_channels ); }
+
+    for( size_t i = 0; i < n_samples; ++i )
+    {
+      const auto channel = event.sample_channel[i];
+      const auto sample = event.sample_sample[i];
+      if( channel >= n_channels || sample >= m_config.n_samples ) continue;
+      m_adc[size_t(sample)*n_channels + m_row[channel]] = event.sample_adc[i];
+    }
+  }
+
+  //* compute features and classify all channels
+  void process()
+  {
+    const int n_rows = m_channels.size();
+    m_adc_max.assign( n_rows, -1e9 );
+    m_sample_max.assign( n_rows, 0 );
+    m_integral.assign( n_rows, 0 );
+    m_time_over_threshold.assign( n_rows, 0 );
+
+    float* adc_max = m_adc_max.data();
+    float* sample_max = m_sample_max.data();
+    float* integral = m_integral.data();
+    float* time_over_threshold = m_time_over_threshold.data();
+    const float* pedestal = m_row_pedestal.data();
+    const float* threshold = m_row_threshold.data();
+
+    const auto first = m_config.feature_window.first;
+    const auto last = std::min( m_config.feature_window.second, m_config.n_samples );
+    for( int sample = first; sample < last; ++sample )
+    {
+      const float* adc = m_adc.data() + size_t(sample)*n_channels;
+      for( int row = 0; row < n_rows; ++row )
+      {
+        const float value = adc[row] - pedestal[row];
+        const bool is_max = value > adc_max[row];
+        adc_max[row] = is_max ? value:adc_max[row];
+        sample_max[row] = is_max ? sample:sample_max[row];
+        integral[row] += value;
+        time_over_threshold[row] += value > threshold[row] ? 1.f:0.f;
+      }
+    }
+
+    // classification
+    m_is_signal.assign( n_rows, 0 );
+    m_is_background.assign( n_rows, 0 );
+    const auto& signal_window = m_config.signal_window;
+    const auto& background_window = m_config.background_window;
+    for( int row = 0; row < n_rows; ++row )
+    {
+      const bool above_threshold = m_row_valid[row] && adc_max[row] > threshold[row];
+      m_is_signal[row] = above_threshold && sample_max[row] >= signal_window.first && sample_max[row] < signal_window.second;
+      m_is_background[row] = above_threshold && sample_max[row] >= background_window.first && sample_max[row] < background_window.second;
+    }
+  }
+
+  //* number of processed channels
+  int n_rows() const
+  { return m_channels.size(); }
+
+  //* channel id for a given row
+  unsigned short channel( int row ) const
+  { return m_channels[row]; }
+
+  //* pedestal subtracted maximum adc
+  float adc_max( int row ) const
+  { return m_adc_max[row]; }
+
+  //* sample at maximum adc
+  int sample_max( int row ) const
+  { return m_sample_max[row]; }
+
+  //* pedestal subtracted integral over feature window
+  float integral( int row ) const
+  { return m_integral[row]; }
+
+  //* number of samples above threshold in feature window
+  int time_over_threshold( int row ) const
+  { return m_time_over_threshold[row]; }
+
+  //* signal flag
+  bool is_signal( int row ) const
+  { return m_is_signal[row]; }
+
+  //* background flag
+  bool is_background( int row ) const
+  { return m_is_background[row]; }
+
+  private:
+
+  //* configuration
+  Config m_config;
+
+  //* pedestal per channel
+  std::vector<float> m_pedestal;
+
+  //* rms per channel
+  std::vector<float> m_rms;
+
+  //* row index per channel, -1 if channel is not present in current event
+  std::vector<int> m_row;
+
+  //* channel per row
+  std::vector<unsigned short> m_channels;
+
+  //*@name per row pedestal and threshold
+  //@{
+  std::vector<float> m_row_pedestal;
+  std::vector<float> m_row_threshold;
+  std::vector<uint8_t> m_row_valid;
+  //@}
+
+  //* adc matrix, stored sample by sample
+  std::vector<float> m_adc;
+
+  //*@name per row features. Stored as float to ease vectorization
+  //@{
+  std::vector<float> m_adc_max;
+  std::vector<float> m_sample_max;
+  std::vector<float> m_integral;
+  std::vector<float> m_time_over_threshold;
+  //@}
+
+  //*@name per row classification
+  //@{
+  std::vector<uint8_t> m_is_signal;
+  std::vector<uint8_t> m_is_background;
+  //@}
+
+};
+
+#endif
@@ -0,0 +1,394 @@
+#ifndef SYNTHETICDATA_H
+#define SYNTHETICDATA_H
+
+#include <TFile.h>
+#include <TString.h>
+#include <TTree.h>
+
+#include <micromegas/MicromegasRawDataEvaluation.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+/*
+ * synthetic TPOT, MBD and INTT trees, to run and benchmark the analysis chain without lustre access
+ * - TPOT: MicromegasRawDataEvaluation trees, with noise waveforms at a configurable occupancy
+ *   and signal clusters of adjacent strips, peaking in the signal sample window used by RawDataClusterTree.C
+ * - MBD: flat trees with the same branches as read by MBD_Correlation.C. The 16 bits clock has an arbitrary origin
+ * - INTT: flat trees with one bco per event and per hit module, chip, channel and adc arrays. The bco matches the TPOT lvl1 bco
+ * a fraction of the TPOT events is dropped from the MBD and INTT sequences, and the same fraction of extra events is added,
+ * to exercise the BCO alignment resynchronisation. Optionally, MBD and INTT clocks are shifted by one unit,
+ * MBD events are split in two consecutive clocks, and bursts of consecutive events are missing from either side.
+ * The index of the matching TPOT event is returned for each MBD and INTT entry, to check the alignment against truth
+ */
+namespace SyntheticData
+{
+
+  //* generator configuration
+  class Config
+  {
+    public:
+
+    //* number of TPOT events
+    int n_events = 2000;
+
+    //* number of samples per waveform
+    int n_samples = 100;
+
+    //* fraction of TPOT channels with a noise waveform, per event
+    double occupancy = 0.02;
+
+    //* mean number of signal clusters per event, all detectors
+    double n_clusters = 2;
+
+    //* maximum number of strips per signal cluster
+    int cluster_size = 4;
+
+    //* pedestal (adc)
+    double pedestal = 70;
+
+    //* noise rms (adc)
+    double noise = 10;
+
+    //* mean signal amplitude (adc)
+    double signal_adc = 400;
+
+    //* fraction of TPOT events missing from the MBD and INTT sequences, and of extra MBD and INTT events
+    double drop_rate = 0.01;
+
+    //* fraction of MBD and INTT events whose clock is shifted by +/-1 with respect to TPOT
+    double bco_jitter = 0;
+
+    //* fraction of MBD events followed by a split event, with clock incremented by one
+    double split_rate = 0;
+
+    //* probability, per TPOT event, that a burst of missing events starts. Applied independently to TPOT and to MBD and INTT
+    double burst_rate = 0;
+
+    //* number of consecutive events missing in a burst
+    int burst_length = 20;
+
+    //* mean number of INTT hits per event
+    double intt_hits = 20;
+
+    //* random seed
+    unsigned int seed = 12345;
+  };
+
+  //* MBD or INTT event
+  class Event
+  {
+    public:
+
+    //* bco
+    uint64_t bco = 0;
+
+    //* index of the matching TPOT event, -1 if none
+    int ref_index = -1;
+  };
+
+  //____________________________________________________________________________
+  class Generator
+  {
+    public:
+
+    //* constructor
+    Generator( const Config& config = Config() ):
+      m_config( config ),
+      m_random( config.seed )
+    {}
+
+    //* write TPOT evaluation tree. Returns lvl1 bco for all events
+    //* events missing from TPOT in bursts are kept, and added to the MBD and INTT sequences written afterwards
+    std::vector<uint64_t> write_tpot_tree( const TString& filename )
+    {
+      std::unique_ptr<TFile> tfile( TFile::Open( filename, "RECREATE" ) );
+      auto tree = new TTree( "T", "T" );
+      auto container = new MicromegasRawDataEvaluation::Container;
+      tree->Branch( "Event", &container );
+
+      std::poisson_distribution<int> noise_channels( m_config.occupancy*n_channels );
+      std::poisson_distribution<int> signal_clusters( m_config.n_clusters );
+      std::uniform_int_distribution<int> channel_distribution( 0, n_channels-1 );
+      std::uniform_int_distribution<int> size_distribution( 1, std::max( 1, m_config.cluster_size ) );
+      std::uniform_real_distribution<double> amplitude_distribution( 0.5*m_config.signal_adc, 1.5*m_config.signal_adc );
+
+      std::bernoulli_distribution burst_distribution( m_config.burst_rate );
+
+      std::vector<uint64_t> bco_list;
+      bco_list.reserve( m_config.n_events );
+      m_tpot_missing.clear();
+      uint64_t bco = first_bco;
+      for( int i = 0; i < m_config.n_events; ++i )
+      {
+        bco += next_bco_gap();
+        if( burst_distribution( m_random ) )
+        {
+          for( int j = 0; j < m_config.burst_length; ++j )
+          {
+            m_tpot_missing.push_back( bco );
+            bco += next_bco_gap();
+          }
+        }
+        bco_list.push_back( bco );
+
+        container->samples.clear();
+        container->waveforms.clear();
+        container->lvl1_bco_list = { bco };
+        container->lvl1_count_list = { uint32_t(i) };
+
+        // noise waveforms
+        const int n_noise = noise_channels( m_random );
+        for( int j = 0; j < n_noise; ++j )
+        { add_waveform( *container, channel_distribution( m_random ), 0 ); }
+
+        // signal clusters
+        const int n_signal = signal_clusters( m_random );
+        for( int j = 0; j < n_signal; ++j )
+        {
+          const int channel = channel_distribution( m_random );
+          const int size = size_distribution( m_random );
+          const double amplitude = amplitude_distribution( m_random );
+          for( int strip = 0; strip < size && (channel%256)+strip < 256; ++strip )
+          { add_waveform( *container, channel+strip, amplitude*(strip == size/2 ? 1:0.5) ); }
+        }
+
+        tree->Fill();
+      }
+
+      tfile->cd();
+      tree->Write();
+      tfile->Close();
+      delete container;
+
+      std::cout << "SyntheticData::Generator::write_tpot_tree - events: " << m_config.n_events << " file: " << filename << std::endl;
+      return bco_list;
+    }
+
+    //* write MBD tree, from TPOT lvl1 bco. Returns the matching TPOT event index for each entry, -1 if none
+    std::vector<int> write_mbd_tree( const TString& filename, const std::vector<uint64_t>& bco_list )
+    {
+      std::unique_ptr<TFile> tfile( TFile::Open( filename, "RECREATE" ) );
+      auto tree = new TTree( "t", "t" );
+
+      int evt = 0;
+      unsigned short clk = 0;
+      unsigned short femclk = 0;
+      float bqs = 0;
+      float bqn = 0;
+      tree->Branch( "evt", &evt, "evt/I" );
+      tree->Branch( "clk", &clk, "clk/s" );
+      tree->Branch( "femclk", &femclk, "femclk/s" );
+      tree->Branch( "bqs", &bqs, "bqs/F" );
+      tree->Branch( "bqn", &bqn, "bqn/F" );
+
+      std::exponential_distribution<float> charge_distribution( 0.01 );
+      std::bernoulli_distribution split_distribution( m_config.split_rate );
+      std::vector<int> ref_index;
+      for( const auto& event:other_sequence( bco_list ) )
+      {
+        clk = (event.bco + mbd_clock_offset)&0xffff;
+        femclk = clk;
+        bqs = charge_distribution( m_random );
+        bqn = charge_distribution( m_random );
+        tree->Fill();
+        ref_index.push_back( event.ref_index );
+        ++evt;
+
+        // split event
+        if( split_distribution( m_random ) )
+        {
+          ++clk;
+          femclk = clk;
+          tree->Fill();
+          ref_index.push_back( -1 );
+          ++evt;
+        }
+      }
+
+      tfile->cd();
+      tree->Write();
+      tfile->Close();
+      std::cout << "SyntheticData::Generator::write_mbd_tree - events: " << evt << " file: " << filename << std::endl;
+      return ref_index;
+    }
+
+    //* write INTT tree, from TPOT lvl1 bco. Returns the matching TPOT event index for each entry, -1 if none
+    std::vector<int> write_intt_tree( const TString& filename, const std::vector<uint64_t>& bco_list )
+    {
+      std::unique_ptr<TFile> tfile( TFile::Open( filename, "RECREATE" ) );
+      auto tree = new TTree( "tree", "tree" );
+
+      Long64_t bco_full = 0;
+      std::vector<int> module;
+      std::vector<int> chip_id;
+      std::vector<int> chan_id;
+      std::vector<int> adc;
+      tree->Branch( "bco", &bco_full, "bco/L" );
+      tree->Branch( "module", &module );
+      tree->Branch( "chip_id", &chip_id );
+      tree->Branch( "chan_id", &chan_id );
+      tree->Branch( "adc", &adc );
+
+      std::poisson_distribution<int> hit_distribution( m_config.intt_hits );
+      std::uniform_int_distribution<int> module_distribution( 0, 13 );
+      std::uniform_int_distribution<int> chip_distribution( 0, 25 );
+      std::uniform_int_distribution<int> chan_distribution( 0, 127 );
+      std::uniform_int_distribution<int> adc_distribution( 0, 7 );
+      std::bernoulli_distribution adjacent_distribution( 0.3 );
+
+      int n_events = 0;
+      std::vector<int> ref_index;
+      for( const auto& event:other_sequence( bco_list ) )
+      {
+        bco_full = event.bco;
+        ref_index.push_back( event.ref_index );
+        module.clear();
+        chip_id.clear();
+        chan_id.clear();
+        adc.clear();
+
+        const int n_hits = hit_distribution( m_random );
+        for( int j = 0; j < n_hits; ++j )
+        {
+          // some hits get an adjacent channel, to form multi-hit clusters
+          const int hit_module = module_distribution( m_random );
+          const int hit_chip = chip_distribution( m_random );
+          const int hit_chan = chan_distribution( m_random );
+          const int n_adjacent = (adjacent_distribution( m_random ) && hit_chan < 127) ? 2:1;
+          for( int k = 0; k < n_adjacent; ++k )
+          {
+            module.push_back( hit_module );
+            chip_id.push_back( hit_chip );
+            chan_id.push_back( hit_chan+k );
+            adc.push_back( adc_distribution( m_random ) );
+          }
+        }
+
+        tree->Fill();
+        ++n_events;
+      }
+
+      tfile->cd();
+      tree->Write();
+      tfile->Close();
+      std::cout << "SyntheticData::Generator::write_intt_tree - events: " << n_events << " file: " << filename << std::endl;
+      return ref_index;
+    }
+
+    private:
+
+    //* number of TPOT channels
+    static constexpr int n_channels = 4096;
+
+    //* first lvl1 bco (40 bits)
+    static constexpr uint64_t first_bco = 0x1234567890;
+
+    //* MBD clock origin, relative to lvl1 bco
+    static constexpr uint64_t mbd_clock_offset = 0x2a5f;
+
+    //* random gap between consecutive bco
+    uint64_t next_bco_gap()
+    {
+      std::exponential_distribution<double> gap_distribution( 1./2000 );
+      return 100 + uint64_t( gap_distribution( m_random ) );
+    }
+
+    /*
+     * other detector sequence, sorted by bco
+     * drop and add events at the configured rate, drop bursts of consecutive events, add the events missing from TPOT,
+     * and shift clocks by one unit at the configured rate
+     */
+    std::vector<Event> other_sequence( const std::vector<uint64_t>& bco_list )
+    {
+      std::bernoulli_distribution drop_distribution( m_config.drop_rate );
+      std::bernoulli_distribution burst_distribution( m_config.burst_rate );
+      std::bernoulli_distribution jitter_distribution( m_config.bco_jitter );
+      std::bernoulli_distribution sign_distribution( 0.5 );
+
+      std::vector<Event> out;
+      out.reserve( bco_list.size() + m_tpot_missing.size() );
+      for( const auto& bco:m_tpot_missing ) out.push_back( { bco, -1 } );
+
+      int burst = 0;
+      for( size_t i = 0; i < bco_list.size(); ++i )
+      {
+        if( burst > 0 ) --burst;
+        else if( m_config.burst_length > 0 && burst_distribution( m_random ) ) burst = m_config.burst_length-1;
+        else if( !drop_distribution( m_random ) )
+        {
+          uint64_t bco = bco_list[i];
+          if( jitter_distribution( m_random ) ) bco = sign_distribution( m_random ) ? bco+1:bco-1;
+          out.push_back( { bco, int(i) } );
+        }
+
+        if( i+1 < bco_list.size() && drop_distribution( m_random ) ) out.push_back( { (bco_list[i] + bco_list[i+1])/2, -1 } );
+      }
+
+      std::sort( out.begin(), out.end(), []( const Event& first, const Event& second ) { return first.bco < second.bco; } );
+      return out;
+    }
+
+    //* add waveform and its samples to container. Signal pulses peak at sample 30
+    void add_waveform( MicromegasRawDataEvaluation::Container& container, int channel, double amplitude )
+    {
+      std::normal_distribution<double> noise_distribution( m_config.pedestal, m_config.noise );
+
+      const unsigned int layer = 55 + channel/2048;
+      const unsigned int tile = (channel/256)%8;
+      const unsigned short strip = channel%256;
+
+      MicromegasRawDataEvaluation::Waveform waveform;
+      waveform.layer = layer;
+      waveform.tile = tile;
+      waveform.strip = strip;
+      waveform.pedestal = m_config.pedestal;
+      waveform.rms = m_config.noise;
+
+      for( int i = 0; i < m_config.n_samples; ++i )
+      {
+        const double pulse = amplitude > 0 ? amplitude*std::exp( -0.5*std::pow( (i-30)/3., 2 ) ):0;
+        const auto adc = (unsigned short) std::clamp<double>( noise_distribution( m_random ) + pulse, 0, 1023 );
+
+        MicromegasRawDataEvaluation::Sample sample;
+        sample.layer = layer;
+        sample.tile = tile;
+        sample.strip = strip;
+        sample.sample = i;
+        sample.adc = adc;
+        container.samples.push_back( sample );
+
+        if( i == 0 || adc > waveform.adc_max )
+        {
+          waveform.adc_max = adc;
+          waveform.sample_max = i;
+        }
+      }
+
+      // same definition as in RawDataClusterTree.C
+      waveform.is_signal =
+        waveform.sample_max >= 20 &&
+        waveform.sample_max < 45 &&
+        waveform.adc_max > waveform.pedestal + 5*waveform.rms;
+      container.waveforms.push_back( waveform );
+    }
+
+    //* configuration
+    Config m_config;
+
+    //* random generator
+    std::mt19937_64 m_random;
+
+    //* bco of events missing from TPOT, filled by write_tpot_tree
+    std::vector<uint64_t> m_tpot_missing;
+
+  };
+
+}
+
+#endif